@@ -1,7 +1,6 @@
 #include <linux/init.h>
 #include <linux/module.h>
 #include <linux/kernel.h>
-#include <linux/list.h>
 #include <linux/string.h>
 #include <linux/proc_fs.h>
 #include <linux/seq_file.h>
@@ -9,7 +8,14 @@
 #include <linux/kthread.h>
 #include <linux/mutex.h>
 #include <linux/delay.h>
+#include <linux/ktime.h>
+#include <linux/log2.h>
+#include <linux/math64.h>
+#include <linux/uaccess.h>
+#include <linux/vmalloc.h>
+#ifndef ELEVATOR_KUNIT
 #include <linux/elevator_syscalls.h>
+#endif
 
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("Group 1");
@@ -17,10 +23,32 @@ MODULE_DESCRIPTION("Pet Elevator Kernel Module");
 
 // Proc file variables
 #define PROC_NAME "elevator"
+#define SUMMARY_PROC_NAME "elevator_summary"
+#define PROC_CHUNK_PETS 64      // Waiting pets printed per seq_file record
 #define NUM_FLOORS 5
 #define MAX_CAPACITY 5
 #define MAX_WEIGHT 50
 
+// Request capture variables
+#define TRACE_PROC_NAME "elevator_trace"
+#define TRACE_RING_SIZE 4096
+
+// Lock statistics variables
+#define LOCKSTAT_PROC_NAME "elevator_lockstat"
+#define LOCKSTAT_BUCKETS 20     // Bucket 0 is < 1us, bucket b is [2^(b-1), 2^b) us, the last is open ended
+
+// Initial and smallest hall call ring size, doubled whenever a queue fills up (must be a power of two)
+#define FLOOR_RING_MIN 16
+
+// Hall call directions, each floor keeps one queue per direction
+#define HALL_UP 0
+#define HALL_DOWN 1
+#define NUM_HALL_CALLS 2
+
+// What one elevator_step did
+#define STEP_LOADED 1
+#define STEP_MOVED 2
+
 // Pet types
 #define PET_CHIHUAHUA 0
 #define PET_PUG 1
@@ -31,22 +59,44 @@ MODULE_DESCRIPTION("Pet Elevator Kernel Module");
 static const int pet_weights[] = {3, 14, 10, 16};
 static const char *pet_names[] = {"Chihuahua", "Pug", "Pughuahua", "Dachshund"};
 
-// Pet structure
+// Pet structure, packed so queues stay contiguous (weight comes from pet_weights[type])
 typedef struct {
-    int type;
-    int start_floor;
-    int destination_floor;
-    int weight;
-    struct list_head list;
+    u8 type;
+    u8 start_floor;
+    u8 destination_floor;
 } Pet;
 
-// Floor structure
+// Consecutive identical waiting pets, stored once with a count
+typedef struct {
+    Pet pet;
+    u16 count;
+} PetRun;
+
+// Hall call queue, waiting pets live in a FIFO ring buffer of runs
+typedef struct {
+    PetRun *ring;           // NULL until the first pet arrives
+    unsigned int head;      // Index of the oldest run
+    unsigned int capacity;  // Always a power of two
+    unsigned int num_runs;
+    int num_waiting;
+} HallQueue;
+
+// Floor structure, pets wait in the up or down queue depending on where they are heading
 typedef struct {
+    HallQueue calls[NUM_HALL_CALLS];
     int num_waiting;
     int waiting_weight;
-    struct list_head waiting_pets;
 } Floor;
 
+// Captured request record (binary layout read by tests/elevator-test/replay.c)
+struct elevator_trace_rec {
+    u64 timestamp_ns;
+    u8 start_floor;
+    u8 destination_floor;
+    u8 type;
+    u8 reserved;
+} __packed;
+
 // Elevator states
 typedef enum {
     OFFLINE,
@@ -56,13 +106,41 @@ typedef enum {
     DOWN
 } ElevatorState;
 
+// Call sites that take elevator_mutex
+typedef enum {
+    LOCK_SITE_RUN,
+    LOCK_SITE_START,
+    LOCK_SITE_ISSUE,
+    LOCK_SITE_STOP,
+    LOCK_SITE_PROC,
+    LOCK_SITE_TRACE,
+    NUM_LOCK_SITES
+} LockSite;
+
+static const char *lock_site_names[] = {
+    "elevator_run", "start_elevator", "issue_request", "stop_elevator", "proc_read", "trace"
+};
+
+// Per-site elevator_mutex statistics
+typedef struct {
+    u64 acquisitions;
+    u64 contended;
+    u64 wait_ns_total;
+    u64 wait_ns_max;
+    u64 hold_ns_total;
+    u64 hold_ns_max;
+    u32 wait_hist[LOCKSTAT_BUCKETS];
+    u32 hold_hist[LOCKSTAT_BUCKETS];
+} LockStat;
+
 // Elevator structure
 typedef struct {
     ElevatorState state;
+    ElevatorState direction;  // UP or DOWN while sweeping, IDLE at rest
     int current_floor;
     int num_pets;
     int current_weight;
-    struct list_head pets_on_elevator;
+    Pet pets_on_elevator[MAX_CAPACITY];  // Boarding order, first num_pets entries are used
     bool should_stop;
 } Elevator;
 
@@ -72,11 +150,33 @@ static Floor floors[NUM_FLOORS];
 static struct mutex elevator_mutex;
 static struct task_struct *elevator_thread;
 static struct proc_dir_entry *proc_entry;
+static struct proc_dir_entry *summary_proc_entry;
+
+// Lock statistics, only touched while holding elevator_mutex
+static LockStat lock_stats[NUM_LOCK_SITES];
+static LockSite lock_holder_site;
+static u64 lock_acquired_ns;
+static struct proc_dir_entry *lockstat_proc_entry;
 
 // Counter for keeping track of pets waiting and being served
 static int total_pets_serviced = 0;
 static int total_pets_waiting = 0;
 
+// Collective control: only board pets heading the way the car sweeps
+static bool collective = true;
+module_param(collective, bool, 0644);
+MODULE_PARM_DESC(collective, "Board only pets heading in the sweep direction (0 = board everyone at the floor)");
+
+// Ring of the most recently accepted requests, oldest entry is trace_head - trace_count
+static bool capture = false;
+module_param(capture, bool, 0644);
+MODULE_PARM_DESC(capture, "Record accepted requests to /proc/" TRACE_PROC_NAME);
+
+static struct elevator_trace_rec trace_ring[TRACE_RING_SIZE];
+static unsigned int trace_head = 0;
+static unsigned int trace_count = 0;
+static struct proc_dir_entry *trace_proc_entry;
+
 // Keeping track of what state the elevator is in
 static const char *get_state_string(ElevatorState state) {
     switch (state) {
@@ -100,91 +200,202 @@ static char get_pet_char(int type) {
     }
 }
 
+// Histogram bucket for a duration
+static int lockstat_bucket(u64 ns) {
+    u64 us = ns / NSEC_PER_USEC;
+    if (us == 0) return 0;
+    return min_t(int, ilog2(us) + 1, LOCKSTAT_BUCKETS - 1);
+}
+
+// Takes elevator_mutex and records the acquisition against a call site
+static void elevator_lock(LockSite site) {
+    LockStat *stat = &lock_stats[site];
+    u64 wait_ns = 0;
+    u64 start, now;
+
+    if (mutex_trylock(&elevator_mutex)) {
+        now = ktime_get_ns();
+    } else {
+        start = ktime_get_ns();
+        mutex_lock(&elevator_mutex);
+        now = ktime_get_ns();
+        wait_ns = now - start;
+        stat->contended++;
+    }
+
+    stat->acquisitions++;
+    stat->wait_ns_total += wait_ns;
+    stat->wait_ns_max = max(stat->wait_ns_max, wait_ns);
+    stat->wait_hist[lockstat_bucket(wait_ns)]++;
+
+    lock_holder_site = site;
+    lock_acquired_ns = now;
+}
+
+// Records how long the current holder kept elevator_mutex and releases it
+static void elevator_unlock(void) {
+    LockStat *stat = &lock_stats[lock_holder_site];
+    u64 hold_ns = ktime_get_ns() - lock_acquired_ns;
+
+    stat->hold_ns_total += hold_ns;
+    stat->hold_ns_max = max(stat->hold_ns_max, hold_ns);
+    stat->hold_hist[lockstat_bucket(hold_ns)]++;
+
+    mutex_unlock(&elevator_mutex);
+}
+
+// Pet's weight
+static int pet_weight(const Pet *pet) {
+    return pet_weights[pet->type];
+}
+
+// The i-th run of waiting pets in a queue, 0 being the front of the queue
+static PetRun *floor_run(HallQueue *queue, unsigned int i) {
+    return &queue->ring[(queue->head + i) & (queue->capacity - 1)];
+}
+
+// Hall call queue for a travel direction
+static int hall_call(ElevatorState dir) {
+    return dir == DOWN ? HALL_DOWN : HALL_UP;
+}
+
+// Whether two requests can share a run
+static bool same_request(const Pet *a, const Pet *b) {
+    return a->type == b->type && a->start_floor == b->start_floor &&
+           a->destination_floor == b->destination_floor;
+}
+
 // Logic for if a pet can board the elevator
 static bool can_board_pet(Pet *pet) {
     return (elevator.num_pets < MAX_CAPACITY) &&
-           (elevator.current_weight + pet->weight <= MAX_WEIGHT);
+           (elevator.current_weight + pet_weight(pet) <= MAX_WEIGHT);
 }
 
-// Adds a pet to a floor
-static int add_pet_to_floor(int floor, Pet *pet) {
-    list_add_tail(&pet->list, &floors[floor].waiting_pets);
-    floors[floor].num_waiting++;
-    floors[floor].waiting_weight += pet->weight;
-    total_pets_waiting++;
+// Moves a queue into a new ring of `capacity` runs, unwrapping it to start at index 0
+static int resize_floor_ring(HallQueue *queue, unsigned int capacity) {
+    unsigned int i;
+    PetRun *ring = kvmalloc_array(capacity, sizeof(PetRun), GFP_KERNEL);
+
+    if (!ring) return -ENOMEM;
+
+    for (i = 0; i < queue->num_runs; i++)
+        ring[i] = *floor_run(queue, i);
+    kvfree(queue->ring);
+
+    queue->ring = ring;
+    queue->head = 0;
+    queue->capacity = capacity;
     return 0;
 }
 
-// Loads pets up (only if not stopping)
-static void load_pets(void) {
-    Pet *pet, *tmp;
-    int floor_index = elevator.current_floor - 1;
-    
-    // Don't load new pets if stop signal received
-    if (elevator.should_stop) {
-        return;
+// Doubles a queue's ring
+static int grow_floor_ring(HallQueue *queue) {
+    return resize_floor_ring(queue, queue->capacity ? queue->capacity * 2 : FLOOR_RING_MIN);
+}
+
+// Gives memory back as a queue drains, so a burst doesn't keep its peak ring:
+// an empty queue frees its ring and one at most a quarter full halves it
+static void shrink_floor_ring(HallQueue *queue) {
+    if (queue->num_runs == 0) {
+        kvfree(queue->ring);
+        queue->ring = NULL;
+        queue->head = 0;
+        queue->capacity = 0;
+    } else if (queue->capacity > FLOOR_RING_MIN && queue->num_runs <= queue->capacity / 4) {
+        resize_floor_ring(queue, queue->capacity / 2); // Keeps the bigger ring if this fails
     }
-    
-    // Don't even try if we're at max capacity
-    if (elevator.num_pets >= MAX_CAPACITY) {
+}
+
+// Adds a pet to the back of its hall call queue, joining the last run if it matches (caller holds elevator_mutex)
+static int add_pet_to_floor(int floor, const Pet *pet) {
+    Floor *f = &floors[floor];
+    HallQueue *q = &f->calls[pet->destination_floor > pet->start_floor ? HALL_UP : HALL_DOWN];
+    PetRun *run = q->num_runs ? floor_run(q, q->num_runs - 1) : NULL;
+
+    if (run && run->count < U16_MAX && same_request(&run->pet, pet)) {
+        run->count++;
+    } else {
+        if (q->num_runs == q->capacity && grow_floor_ring(q)) {
+            return -ENOMEM;
+        }
+        run = floor_run(q, q->num_runs);
+        run->pet = *pet;
+        run->count = 1;
+        q->num_runs++;
+    }
+
+    q->num_waiting++;
+    f->num_waiting++;
+    f->waiting_weight += pet_weight(pet);
+    total_pets_waiting++;
+    return 0;
+}
+
+// Records an accepted request in the capture ring (caller holds elevator_mutex)
+static void record_request(int start_floor, int dest_floor, int type) {
+    struct elevator_trace_rec *rec;
+
+    if (!READ_ONCE(capture)) {
         return;
     }
-    
-    list_for_each_entry_safe(pet, tmp, &floors[floor_index].waiting_pets, list) {
-        // Skip pets whose destination is current floor
-        if (pet->destination_floor == elevator.current_floor) {
-            continue;
-        }
-        
-        // Try to board if possible
-        if (can_board_pet(pet)) {
-            list_del(&pet->list);
-            floors[floor_index].num_waiting--;
-            floors[floor_index].waiting_weight -= pet->weight;
-            total_pets_waiting--;
 
-            list_add_tail(&pet->list, &elevator.pets_on_elevator);
-            elevator.num_pets++;
-            elevator.current_weight += pet->weight;
-        } else {
-            // Can't board this pet or any after it (FIFO and weight constraints)
-            break;
-        }
+    rec = &trace_ring[trace_head];
+    rec->timestamp_ns = ktime_get_ns();
+    rec->start_floor = start_floor;
+    rec->destination_floor = dest_floor;
+    rec->type = type;
+    rec->reserved = 0;
+
+    trace_head = (trace_head + 1) % TRACE_RING_SIZE;
+    if (trace_count < TRACE_RING_SIZE) {
+        trace_count++;
     }
 }
 
-// Unloads pets
+// Unloads pets, keeping the rest in boarding order
 static void unload_pets(void) {
-    Pet *pet, *tmp;
-    list_for_each_entry_safe(pet, tmp, &elevator.pets_on_elevator, list) {
+    int i, kept = 0;
+    for (i = 0; i < elevator.num_pets; i++) {
+        Pet *pet = &elevator.pets_on_elevator[i];
         if (pet->destination_floor == elevator.current_floor) {
-            list_del(&pet->list);
-            elevator.num_pets--;
-            elevator.current_weight -= pet->weight;
+            elevator.current_weight -= pet_weight(pet);
             total_pets_serviced++;
-            kfree(pet);
+        } else {
+            elevator.pets_on_elevator[kept++] = *pet;
         }
     }
+    elevator.num_pets = kept;
+}
+
+// Drops every pet on the elevator and frees the floor queues (caller holds elevator_mutex)
+static void free_all_pets(void) {
+    int i, j;
+
+    for (i = 0; i < NUM_FLOORS; i++) {
+        for (j = 0; j < NUM_HALL_CALLS; j++) {
+            kvfree(floors[i].calls[j].ring);
+            floors[i].calls[j] = (HallQueue){ 0 };
+        }
+        floors[i].num_waiting = 0;
+        floors[i].waiting_weight = 0;
+    }
+    elevator.num_pets = 0;
+    elevator.current_weight = 0;
+    total_pets_waiting = 0;
 }
 
 // Check if pets need to get off at current floor
 static bool needs_to_unload(void) {
-    Pet *pet;
-    list_for_each_entry(pet, &elevator.pets_on_elevator, list) {
-        if (pet->destination_floor == elevator.current_floor) {
+    int i;
+    for (i = 0; i < elevator.num_pets; i++) {
+        if (elevator.pets_on_elevator[i].destination_floor == elevator.current_floor) {
             return true;
         }
     }
     return false;
 }
 
-// Check if pets are waiting at current floor
-static bool has_waiting_pets(void) {
-    int floor_index = elevator.current_floor - 1;
-    return floors[floor_index].num_waiting > 0 && !elevator.should_stop;
-}
-
-// Check the pets waiting above
+// Check the pets waiting above (either queue, a down call above still needs the car to go up)
 static bool pets_waiting_above(void) {
     int i;
     if (elevator.should_stop) return false; // Does not consider waiting on pets if stopping
@@ -193,7 +404,7 @@ static bool pets_waiting_above(void) {
     return false;
 }
 
-// Check the pets waiting below
+// Check the pets waiting below (either queue, an up call below still needs the car to go down)
 static bool pets_waiting_below(void) {
     int i;
     if (elevator.should_stop) return false; // Does not consider waiting on pets if stopping
@@ -204,22 +415,113 @@ static bool pets_waiting_below(void) {
 
 // Check the pets going up
 static bool pets_going_up(void) {
-    Pet *pet;
-    list_for_each_entry(pet, &elevator.pets_on_elevator, list)
-        if (pet->destination_floor > elevator.current_floor) return true;
+    int i;
+    for (i = 0; i < elevator.num_pets; i++)
+        if (elevator.pets_on_elevator[i].destination_floor > elevator.current_floor) return true;
     return false;
 }
 
 // Check the pets going down
 static bool pets_going_down(void) {
-    Pet *pet;
-    list_for_each_entry(pet, &elevator.pets_on_elevator, list)
-        if (pet->destination_floor < elevator.current_floor) return true;
+    int i;
+    for (i = 0; i < elevator.num_pets; i++)
+        if (elevator.pets_on_elevator[i].destination_floor < elevator.current_floor) return true;
     return false;
 }
 
+// Direction the car boards for at the current floor: its sweep direction, unless nothing
+// on board or waiting further along needs that direction and the car is about to reverse
+static ElevatorState boarding_direction(void) {
+    Floor *floor = &floors[elevator.current_floor - 1];
+    ElevatorState dir = elevator.direction;
+
+    // At rest, serve the up queue first
+    if (dir != UP && dir != DOWN) {
+        dir = floor->calls[HALL_UP].num_waiting > 0 ? UP : DOWN;
+    }
+
+    if (floor->calls[hall_call(dir)].num_waiting == 0) {
+        if (dir == UP && !pets_going_up() && !pets_waiting_above()) {
+            dir = DOWN;
+        } else if (dir == DOWN && !pets_going_down() && !pets_waiting_below()) {
+            dir = UP;
+        }
+    }
+    return dir;
+}
+
+// Check if pets are waiting at current floor that the car would pick up
+static bool has_waiting_pets(void) {
+    Floor *floor = &floors[elevator.current_floor - 1];
+    if (elevator.should_stop) return false;
+    if (!READ_ONCE(collective)) return floor->num_waiting > 0;
+    return floor->calls[hall_call(boarding_direction())].num_waiting > 0;
+}
+
+// Boards pets from the front of one hall call queue (pets never wait for their own floor),
+// taking as many pets from each run as capacity and weight allow. Returns false if a pet
+// had to stay behind.
+static bool board_from_queue(Floor *floor, HallQueue *queue) {
+    PetRun *run;
+
+    while (queue->num_runs > 0) {
+        run = floor_run(queue, 0);
+
+        while (run->count > 0 && can_board_pet(&run->pet)) {
+            elevator.pets_on_elevator[elevator.num_pets++] = run->pet;
+            elevator.current_weight += pet_weight(&run->pet);
+
+            run->count--;
+            queue->num_waiting--;
+            floor->num_waiting--;
+            floor->waiting_weight -= pet_weight(&run->pet);
+            total_pets_waiting--;
+        }
+
+        // Can't board the rest of this run or anything after it (FIFO and weight constraints)
+        if (run->count > 0) {
+            return false;
+        }
+
+        queue->head = (queue->head + 1) & (queue->capacity - 1);
+        queue->num_runs--;
+        shrink_floor_ring(queue);
+    }
+    return true;
+}
+
+// Loads pets up (only if not stopping)
+static void load_pets(void) {
+    Floor *floor = &floors[elevator.current_floor - 1];
+    ElevatorState dir;
+    
+    // Don't load new pets if stop signal received
+    if (elevator.should_stop) {
+        return;
+    }
+    
+    // Don't even try if we're at max capacity
+    if (elevator.num_pets >= MAX_CAPACITY) {
+        return;
+    }
+    
+    dir = boarding_direction();
+    if (READ_ONCE(collective)) {
+        // Only pets heading our way; turning around here makes the other queue ours
+        if (floor->calls[hall_call(dir)].num_waiting > 0) {
+            elevator.direction = dir;
+            board_from_queue(floor, &floor->calls[hall_call(dir)]);
+        }
+    } else if (board_from_queue(floor, &floor->calls[hall_call(dir)])) {
+        board_from_queue(floor, &floor->calls[!hall_call(dir)]);
+    }
+}
+
 // Determine next state
 static ElevatorState determine_next_direction(void) {
+    // With collective=0 a LOADING stop ends the sweep, so the car picks a new direction
+    ElevatorState sweep = READ_ONCE(collective) ? elevator.direction : elevator.state;
+
     // If a stop is requested and there are no pets on board then go offline
     if (elevator.should_stop && elevator.num_pets == 0) {
         return OFFLINE;
@@ -238,13 +540,13 @@ static ElevatorState determine_next_direction(void) {
     bool can_take_more = (elevator.num_pets < MAX_CAPACITY) && 
                          (elevator.current_weight < MAX_WEIGHT);
     
-    if (elevator.state == UP) {
+    if (sweep == UP) {
         if (pets_going_up() || (can_take_more && pets_waiting_above())) {
             return UP;
         }
     }
     
-    if (elevator.state == DOWN) {
+    if (sweep == DOWN) {
         if (pets_going_down() || (can_take_more && pets_waiting_below())) {
             return DOWN;
         }
@@ -273,103 +575,107 @@ static ElevatorState determine_next_direction(void) {
     return IDLE;
 }
 
-// Elevator thread
-static int elevator_run(void *data) {
-    bool should_load_unload;
+// Picks the next state and remembers the travel direction for the sweep
+static void set_next_state(void) {
+    elevator.state = determine_next_direction();
+    elevator.direction = (elevator.state == UP || elevator.state == DOWN) ? elevator.state : IDLE;
+}
+
+// One pass of the elevator loop: load/unload if needed, pick the next state and
+// move a floor. Called with the lock held; pause() drops it while the car waits.
+// Returns STEP_LOADED and/or STEP_MOVED.
+static int elevator_step(void (*pause)(unsigned int seconds)) {
+    int done = 0;
+    
+    if (elevator.state == OFFLINE) {
+        pause(1);
+        return 0;
+    }
+    
+    // Check if we need to load/unload at current floor
+    if (needs_to_unload() || has_waiting_pets()) {
+        // Enter loading state and wait 1 second for loading
+        elevator.state = LOADING;
+        pause(1);
+        unload_pets();
+        load_pets();
+        done |= STEP_LOADED;
+    }
     
+    // Determine next direction
+    set_next_state();
+    
+    // Move elevator
+    if (elevator.state == UP && elevator.current_floor < NUM_FLOORS) {
+        pause(2);
+        elevator.current_floor++;
+        done |= STEP_MOVED;
+    } else if (elevator.state == DOWN && elevator.current_floor > 1) {
+        pause(2);
+        elevator.current_floor--;
+        done |= STEP_MOVED;
+    } else if (elevator.state == IDLE || elevator.state == OFFLINE) {
+        pause(1);
+    }
+    return done;
+}
+
+#ifndef ELEVATOR_KUNIT
+// Sleeps without holding the lock
+static void elevator_pause(unsigned int seconds) {
+    elevator_unlock();
+    ssleep(seconds);
+    elevator_lock(LOCK_SITE_RUN);
+}
+
+// Elevator thread (not started in the KUnit build)
+static int elevator_run(void *data) {
     while (!kthread_should_stop()) {
-        mutex_lock(&elevator_mutex);
-        
-        if (elevator.state == OFFLINE) {
-            mutex_unlock(&elevator_mutex);
-            ssleep(1);
-            continue;
-        }
-        
-        // Check if we need to load/unload at current floor
-        should_load_unload = needs_to_unload() || has_waiting_pets();
-        
-        if (should_load_unload) {
-            // Enter loading state
-            elevator.state = LOADING;
-            mutex_unlock(&elevator_mutex);
-            
-            // Wait 1 second for loading
-            ssleep(1);
-            
-            mutex_lock(&elevator_mutex);
-            unload_pets();
-            load_pets();
-            mutex_unlock(&elevator_mutex);
-        } else {
-            mutex_unlock(&elevator_mutex);
-        }
-        
-        // Determine next direction
-        mutex_lock(&elevator_mutex);
-        elevator.state = determine_next_direction();
-        
-        // Move elevator
-        if (elevator.state == UP && elevator.current_floor < NUM_FLOORS) {
-            mutex_unlock(&elevator_mutex);
-            ssleep(2);
-            mutex_lock(&elevator_mutex);
-            elevator.current_floor++;
-            mutex_unlock(&elevator_mutex);
-        } else if (elevator.state == DOWN && elevator.current_floor > 1) {
-            mutex_unlock(&elevator_mutex);
-            ssleep(2);
-            mutex_lock(&elevator_mutex);
-            elevator.current_floor--;
-            mutex_unlock(&elevator_mutex);
-        } else if (elevator.state == IDLE || elevator.state == OFFLINE) {
-            mutex_unlock(&elevator_mutex);
-            ssleep(1);
-        } else {
-            mutex_unlock(&elevator_mutex);
-        }
+        elevator_lock(LOCK_SITE_RUN);
+        elevator_step(elevator_pause);
+        elevator_unlock();
         
         msleep(100); // Delay so things don't get too crazy
     }
     return 0;
 }
+#endif
 
 // Syscall implementations
 static int start_elevator_impl(void) {
-    mutex_lock(&elevator_mutex);
+    elevator_lock(LOCK_SITE_START);
     if (elevator.state != OFFLINE) { 
-        mutex_unlock(&elevator_mutex); 
+        elevator_unlock(); 
         return 1; 
     }
     elevator.state = IDLE;
+    elevator.direction = IDLE;
     elevator.current_floor = 1;
     elevator.num_pets = 0;
     elevator.current_weight = 0;
     elevator.should_stop = false;
-    mutex_unlock(&elevator_mutex);
+    elevator_unlock();
     printk(KERN_INFO "elevator: started\n");
     return 0;
 }
 
 static int issue_request_impl(int start_floor, int dest_floor, int type) {
-    Pet *pet;
+    Pet pet;
+    int ret;
     if (start_floor < 1 || start_floor > NUM_FLOORS ||
         dest_floor < 1 || dest_floor > NUM_FLOORS ||
         type < 0 || type > 3 ||
         start_floor == dest_floor) return 1;
 
-    pet = kmalloc(sizeof(Pet), GFP_KERNEL);
-    if (!pet) return -ENOMEM;
+    pet.type = type;
+    pet.start_floor = start_floor;
+    pet.destination_floor = dest_floor;
 
-    pet->type = type;
-    pet->start_floor = start_floor;
-    pet->destination_floor = dest_floor;
-    pet->weight = pet_weights[type];
-    INIT_LIST_HEAD(&pet->list);
-
-    mutex_lock(&elevator_mutex);
-    add_pet_to_floor(start_floor - 1, pet);
-    mutex_unlock(&elevator_mutex);
+    elevator_lock(LOCK_SITE_ISSUE);
+    ret = add_pet_to_floor(start_floor - 1, &pet);
+    if (!ret) record_request(start_floor, dest_floor, type);
+    elevator_unlock();
+    if (ret) return ret;
 
     printk(KERN_INFO "elevator: %s added to floor %d -> %d\n",
            pet_names[type], start_floor, dest_floor);
@@ -377,62 +683,370 @@ static int issue_request_impl(int start_floor, int dest_floor, int type) {
 }
 
 static int stop_elevator_impl(void) {
-    mutex_lock(&elevator_mutex);
+    elevator_lock(LOCK_SITE_STOP);
     if (elevator.should_stop || elevator.state == OFFLINE) { 
-        mutex_unlock(&elevator_mutex); 
+        elevator_unlock(); 
         return 1; 
     }
     elevator.should_stop = true;
-    mutex_unlock(&elevator_mutex);
+    elevator_unlock();
     printk(KERN_INFO "elevator: stop requested\n");
     return 0;
 }
 
-// Proc file
-static int elevator_proc_show(struct seq_file *m, void *v) {
+// Proc file, streamed one record at a time: the header, then each floor from the top
+// in chunks of PROC_CHUNK_PETS waiting pets (up queue, then down queue), then the
+// totals. The lock is only held while seq_file fills one buffer, so a queue that
+// changes between reads can shift a chunk.
+typedef struct {
+    bool summary;       // Counts only, no per-pet listing
+    int floor;          // NUM_FLOORS for the header, -1 for the totals, otherwise a floor index
+    unsigned int chunk; // Chunk of the floor's queues
+    int call;           // Hall call queue, run and offset in it of the chunk's first pet
+    unsigned int run;
+    unsigned int offset;
+    loff_t pos;         // Record the cursor points at, -1 once it has to seek again
+    int last_floor;     // Floor of the last record shown, PROC_NOTHING before the header
+    bool line_open;     // The last record shown left its floor's line unfinished
+} ProcCursor;
+
+#define PROC_NOTHING (NUM_FLOORS + 1)
+
+// Number of records a floor takes up
+static unsigned int proc_floor_chunks(const ProcCursor *c, int floor) {
+    if (c->summary || floors[floor].num_waiting == 0) return 1;
+    return DIV_ROUND_UP(floors[floor].num_waiting, PROC_CHUNK_PETS);
+}
+
+// Steps the cursor past used up runs and queues, so it points at a waiting pet
+// or has call == NUM_HALL_CALLS once the floor's queues are used up
+static void proc_settle(ProcCursor *c) {
+    HallQueue *queue;
+
+    while (c->call < NUM_HALL_CALLS) {
+        queue = &floors[c->floor].calls[c->call];
+        if (c->run >= queue->num_runs) {
+            c->call++;
+            c->run = 0;
+            c->offset = 0;
+        } else if (c->offset >= floor_run(queue, c->run)->count) {
+            c->run++;
+            c->offset = 0;
+        } else {
+            return;
+        }
+    }
+}
+
+// Moves the cursor forward by `pets` waiting pets on its floor
+static void proc_skip_pets(ProcCursor *c, unsigned int pets) {
+    unsigned int left;
+
+    proc_settle(c);
+    while (pets > 0 && c->call < NUM_HALL_CALLS) {
+        left = floor_run(&floors[c->floor].calls[c->call], c->run)->count - c->offset;
+        if (pets < left) {
+            c->offset += pets;
+            return;
+        }
+        pets -= left;
+        c->run++;
+        c->offset = 0;
+        proc_settle(c);
+    }
+}
+
+// Points the cursor at the first pet of a floor's chunk (or at the header or totals)
+static void *proc_point(ProcCursor *c, int floor, unsigned int chunk) {
+    c->floor = floor;
+    c->chunk = chunk;
+    c->call = HALL_UP;
+    c->run = 0;
+    c->offset = 0;
+    if (floor >= 0 && floor < NUM_FLOORS && !c->summary) proc_skip_pets(c, chunk * PROC_CHUNK_PETS);
+    return c;
+}
+
+// Points the cursor at record `pos`, or returns NULL past the end. This walks
+// the floor's runs, so it is only used when a read does not carry on from the last.
+static void *elevator_seq_seek(ProcCursor *c, loff_t pos) {
     int i;
+    unsigned int chunks;
+
+    if (pos == 0) return proc_point(c, NUM_FLOORS, 0);
+    pos--;
+
+    for (i = NUM_FLOORS - 1; i >= 0; i--) {
+        chunks = proc_floor_chunks(c, i);
+        if (pos < chunks) return proc_point(c, i, pos);
+        pos -= chunks;
+    }
+
+    if (pos == 0) return proc_point(c, -1, 0);
+    return NULL;
+}
+
+static void *elevator_seq_start(struct seq_file *m, loff_t *pos) {
+    ProcCursor *c = m->private;
+    void *v;
+
+    elevator_lock(LOCK_SITE_PROC);
+    if (*pos == 0) {
+        c->last_floor = PROC_NOTHING;
+        c->line_open = false;
+    }
+
+    // A read that carries on from the last one resumes where next() left the cursor
+    if (*pos != 0 && *pos == c->pos) return c;
+    v = elevator_seq_seek(c, *pos);
+
+    // Queues that shrank since the last read can move the end up, still finish with the totals
+    if (!v && c->last_floor >= 0 && c->last_floor != PROC_NOTHING) v = proc_point(c, -1, 0);
+    c->pos = v ? *pos : -1;
+    return v;
+}
+
+static void *elevator_seq_next(struct seq_file *m, void *v, loff_t *pos) {
+    ProcCursor *c = v;
+    ++*pos;
+
+    c->last_floor = c->floor;
+    c->line_open = false;
+    c->pos = *pos;
+
+    // The totals are the last record
+    if (c->floor < 0) {
+        c->pos = -1;
+        return NULL;
+    }
+
+    // The next chunk of the same floor starts where this one ended
+    if (c->floor < NUM_FLOORS && !c->summary) {
+        proc_skip_pets(c, PROC_CHUNK_PETS);
+        if (c->call < NUM_HALL_CALLS) {
+            c->chunk++;
+            c->line_open = true;
+            return c;
+        }
+    }
+
+    // Then the floor below, and the totals after floor 1
+    return proc_point(c, c->floor - 1, 0);
+}
+
+static void elevator_seq_stop(struct seq_file *m, void *v) {
+    elevator_unlock();
+}
+
+static int elevator_seq_show(struct seq_file *m, void *v) {
+    ProcCursor *c = v;
+    ProcCursor at;
+    Floor *floor;
+    PetRun *run;
     Pet *pet;
-    mutex_lock(&elevator_mutex);
+    int i;
+    unsigned int j;
+    bool continues = c->line_open && c->last_floor == c->floor && c->chunk > 0;
 
-    seq_printf(m, "Elevator state: %s\n", get_state_string(elevator.state));
-    seq_printf(m, "Current floor: %d\n", elevator.current_floor);
-    seq_printf(m, "Current load: %d lbs\n", elevator.current_weight);
+    // A read that resumes somewhere else after the queues changed finishes the open line first
+    if (c->line_open && !continues) {
+        seq_puts(m, "\n");
+    }
 
-    seq_printf(m, "Elevator status: ");
-    if (list_empty(&elevator.pets_on_elevator)) {
-        seq_puts(m, "empty");
-    } else {
-        list_for_each_entry(pet, &elevator.pets_on_elevator, list)
-            seq_printf(m, "%c%d ", get_pet_char(pet->type), pet->destination_floor);
+    if (c->floor == NUM_FLOORS) {
+        seq_printf(m, "Elevator state: %s\n", get_state_string(elevator.state));
+        seq_printf(m, "Current floor: %d\n", elevator.current_floor);
+        seq_printf(m, "Current load: %d lbs\n", elevator.current_weight);
+
+        seq_printf(m, "Elevator status: ");
+        if (elevator.num_pets == 0) {
+            seq_puts(m, "empty");
+        } else {
+            for (i = 0; i < elevator.num_pets; i++) {
+                pet = &elevator.pets_on_elevator[i];
+                seq_printf(m, "%c%d ", get_pet_char(pet->type), pet->destination_floor);
+            }
+        }
+        seq_puts(m, "\n");
+        return 0;
     }
-    seq_puts(m, "\n");
 
-    for (i = NUM_FLOORS-1; i >= 0; i--) {
-        seq_printf(m, "[%c] Floor %d: %d ", (elevator.current_floor == i+1?'*':' '), i+1, floors[i].num_waiting);
-        list_for_each_entry(pet, &floors[i].waiting_pets, list)
-            seq_printf(m, "%c%d ", get_pet_char(pet->type), pet->destination_floor);
+    if (c->floor < 0) {
+        seq_printf(m, "Number of pets: %d\n", elevator.num_pets);
+        seq_printf(m, "Number of pets waiting: %d\n", total_pets_waiting);
+        seq_printf(m, "Number of pets serviced: %d\n", total_pets_serviced);
+        return 0;
+    }
+
+    // A chunk that does not continue the line (e.g. after a seek) gets its own header
+    floor = &floors[c->floor];
+    if (!continues) {
+        seq_printf(m, "[%c] Floor %d: %d ", (elevator.current_floor == c->floor+1?'*':' '), c->floor+1, floor->num_waiting);
+    }
+    if (c->summary) {
         seq_puts(m, "\n");
+        return 0;
     }
 
-    seq_printf(m, "Number of pets: %d\n", elevator.num_pets);
-    seq_printf(m, "Number of pets waiting: %d\n", total_pets_waiting);
-    seq_printf(m, "Number of pets serviced: %d\n", total_pets_serviced);
-    mutex_unlock(&elevator_mutex);
+    at = *c;
+    proc_settle(&at);
+    for (j = 0; j < PROC_CHUNK_PETS && at.call < NUM_HALL_CALLS; j++) {
+        run = floor_run(&floor->calls[at.call], at.run);
+        seq_printf(m, "%c%d ", get_pet_char(run->pet.type), run->pet.destination_floor);
+        at.offset++;
+        proc_settle(&at);
+    }
+
+    // The line ends once both hall call queues are used up
+    if (at.call == NUM_HALL_CALLS) {
+        seq_puts(m, "\n");
+    }
+    return 0;
+}
+
+static const struct seq_operations elevator_seq_ops = {
+    .start = elevator_seq_start,
+    .next = elevator_seq_next,
+    .stop = elevator_seq_stop,
+    .show = elevator_seq_show,
+};
+
+// Opens the proc file, with or without the per-pet listing
+static int elevator_proc_open_view(struct file *file, bool summary) {
+    ProcCursor *c = __seq_open_private(file, &elevator_seq_ops, sizeof(ProcCursor));
+    if (!c) return -ENOMEM;
+    c->summary = summary;
     return 0;
 }
 
-// Opens the proc file
 static int elevator_proc_open(struct inode *inode, struct file *file) {
-    return single_open(file, elevator_proc_show, NULL);
+    return elevator_proc_open_view(file, false);
+}
+
+static int elevator_summary_open(struct inode *inode, struct file *file) {
+    return elevator_proc_open_view(file, true);
 }
 
 static const struct proc_ops elevator_proc_fops = {
     .proc_open = elevator_proc_open,
     .proc_read = seq_read,
     .proc_lseek = seq_lseek,
+    .proc_release = seq_release_private,
+};
+
+static const struct proc_ops elevator_summary_fops = {
+    .proc_open = elevator_summary_open,
+    .proc_read = seq_read,
+    .proc_lseek = seq_lseek,
+    .proc_release = seq_release_private,
+};
+
+// Prints the non-empty buckets of a lock histogram
+static void lockstat_show_hist(struct seq_file *m, const char *name, const u32 *hist) {
+    int b;
+    seq_printf(m, "  %s:", name);
+    for (b = 0; b < LOCKSTAT_BUCKETS; b++) {
+        if (!hist[b]) continue;
+        if (b == 0)
+            seq_printf(m, " <1us:%u", hist[b]);
+        else
+            seq_printf(m, " %luus+:%u", 1UL << (b - 1), hist[b]);
+    }
+    seq_puts(m, "\n");
+}
+
+// Lock statistics file (reads take the mutex directly so they are not counted)
+static int elevator_lockstat_show(struct seq_file *m, void *v) {
+    int i;
+    mutex_lock(&elevator_mutex);
+    for (i = 0; i < NUM_LOCK_SITES; i++) {
+        LockStat *stat = &lock_stats[i];
+        u64 acq = stat->acquisitions ? stat->acquisitions : 1;
+
+        seq_printf(m, "%s: acquisitions %llu contended %llu\n", lock_site_names[i],
+                   stat->acquisitions, stat->contended);
+        seq_printf(m, "  wait avg %llu ns max %llu ns, hold avg %llu ns max %llu ns\n",
+                   div64_u64(stat->wait_ns_total, acq), stat->wait_ns_max,
+                   div64_u64(stat->hold_ns_total, acq), stat->hold_ns_max);
+        lockstat_show_hist(m, "wait", stat->wait_hist);
+        lockstat_show_hist(m, "hold", stat->hold_hist);
+    }
+    mutex_unlock(&elevator_mutex);
+    return 0;
+}
+
+static int elevator_lockstat_open(struct inode *inode, struct file *file) {
+    return single_open(file, elevator_lockstat_show, NULL);
+}
+
+// Any write resets the statistics
+static ssize_t elevator_lockstat_write(struct file *file, const char __user *buf, size_t count, loff_t *ppos) {
+    mutex_lock(&elevator_mutex);
+    memset(lock_stats, 0, sizeof(lock_stats));
+    mutex_unlock(&elevator_mutex);
+    return count;
+}
+
+static const struct proc_ops elevator_lockstat_fops = {
+    .proc_open = elevator_lockstat_open,
+    .proc_read = seq_read,
+    .proc_write = elevator_lockstat_write,
+    .proc_lseek = seq_lseek,
     .proc_release = single_release,
 };
 
+// Capture buffer handed to a reader, snapshotted on open so reads see one consistent trace
+struct elevator_trace_snapshot {
+    size_t len;
+    struct elevator_trace_rec recs[];
+};
+
+// Opens the trace file and copies the ring out oldest first
+static int elevator_trace_open(struct inode *inode, struct file *file) {
+    struct elevator_trace_snapshot *snap;
+    unsigned int i, first;
+
+    snap = kvmalloc(struct_size(snap, recs, TRACE_RING_SIZE), GFP_KERNEL);
+    if (!snap) return -ENOMEM;
+
+    elevator_lock(LOCK_SITE_TRACE);
+    first = (trace_head + TRACE_RING_SIZE - trace_count) % TRACE_RING_SIZE;
+    for (i = 0; i < trace_count; i++)
+        snap->recs[i] = trace_ring[(first + i) % TRACE_RING_SIZE];
+    snap->len = trace_count * sizeof(struct elevator_trace_rec);
+    elevator_unlock();
+
+    file->private_data = snap;
+    return 0;
+}
+
+static ssize_t elevator_trace_read(struct file *file, char __user *buf, size_t count, loff_t *ppos) {
+    struct elevator_trace_snapshot *snap = file->private_data;
+    return simple_read_from_buffer(buf, count, ppos, snap->recs, snap->len);
+}
+
+// Any write clears the captured trace
+static ssize_t elevator_trace_write(struct file *file, const char __user *buf, size_t count, loff_t *ppos) {
+    elevator_lock(LOCK_SITE_TRACE);
+    trace_head = 0;
+    trace_count = 0;
+    elevator_unlock();
+    return count;
+}
+
+static int elevator_trace_release(struct inode *inode, struct file *file) {
+    kvfree(file->private_data);
+    return 0;
+}
+
+static const struct proc_ops elevator_trace_fops = {
+    .proc_open = elevator_trace_open,
+    .proc_read = elevator_trace_read,
+    .proc_write = elevator_trace_write,
+    .proc_lseek = default_llseek,
+    .proc_release = elevator_trace_release,
+};
+
 // Module init/exit
 static int __init elevator_init(void) {
     int i;
@@ -441,14 +1055,15 @@ static int __init elevator_init(void) {
     mutex_init(&elevator_mutex);
 
     elevator.state = OFFLINE;
+    elevator.direction = IDLE;
     elevator.current_floor = 1;
     elevator.num_pets = 0;
     elevator.current_weight = 0;
     elevator.should_stop = false;
-    INIT_LIST_HEAD(&elevator.pets_on_elevator);
 
     for (i = 0; i < NUM_FLOORS; i++) {
-        INIT_LIST_HEAD(&floors[i].waiting_pets);
+        floors[i].calls[HALL_UP] = (HallQueue){ 0 };
+        floors[i].calls[HALL_DOWN] = (HallQueue){ 0 };
         floors[i].num_waiting = 0;
         floors[i].waiting_weight = 0;
     }
@@ -456,8 +1071,36 @@ static int __init elevator_init(void) {
     proc_entry = proc_create(PROC_NAME, 0444, NULL, &elevator_proc_fops);
     if (!proc_entry) return -ENOMEM;
 
+    summary_proc_entry = proc_create(SUMMARY_PROC_NAME, 0444, NULL, &elevator_summary_fops);
+    if (!summary_proc_entry) {
+        remove_proc_entry(PROC_NAME, NULL);
+        return -ENOMEM;
+    }
+
+    trace_proc_entry = proc_create(TRACE_PROC_NAME, 0644, NULL, &elevator_trace_fops);
+    if (!trace_proc_entry) {
+        remove_proc_entry(SUMMARY_PROC_NAME, NULL);
+        remove_proc_entry(PROC_NAME, NULL);
+        return -ENOMEM;
+    }
+
+    lockstat_proc_entry = proc_create(LOCKSTAT_PROC_NAME, 0644, NULL, &elevator_lockstat_fops);
+    if (!lockstat_proc_entry) {
+        remove_proc_entry(TRACE_PROC_NAME, NULL);
+        remove_proc_entry(SUMMARY_PROC_NAME, NULL);
+        remove_proc_entry(PROC_NAME, NULL);
+        return -ENOMEM;
+    }
+
+#ifdef ELEVATOR_KUNIT
+    // The KUnit suite drives the state machine itself and there are no syscalls to hook
+    printk(KERN_INFO "elevator: KUnit build, thread and syscalls disabled\n");
+#else
     elevator_thread = kthread_run(elevator_run, NULL, "elevator_thread");
     if (IS_ERR(elevator_thread)) { 
+        remove_proc_entry(LOCKSTAT_PROC_NAME, NULL);
+        remove_proc_entry(TRACE_PROC_NAME, NULL);
+        remove_proc_entry(SUMMARY_PROC_NAME, NULL);
         remove_proc_entry(PROC_NAME, NULL); 
         return PTR_ERR(elevator_thread); 
     }
@@ -468,35 +1111,34 @@ static int __init elevator_init(void) {
     stop_elevator_syscall = stop_elevator_impl;
 
     printk(KERN_INFO "elevator: syscalls registered\n");
+#endif
     return 0;
 }
 
 static void __exit elevator_exit(void) {
-    int i;
-    Pet *pet, *tmp;
-
+#ifndef ELEVATOR_KUNIT
     // Clear the syscall function pointers
     start_elevator_syscall = NULL;
     issue_request_syscall = NULL;
     stop_elevator_syscall = NULL;
+#endif
 
     if (elevator_thread) kthread_stop(elevator_thread);
+    remove_proc_entry(LOCKSTAT_PROC_NAME, NULL);
+    remove_proc_entry(TRACE_PROC_NAME, NULL);
+    remove_proc_entry(SUMMARY_PROC_NAME, NULL);
     remove_proc_entry(PROC_NAME, NULL);
 
     mutex_lock(&elevator_mutex);
-    list_for_each_entry_safe(pet, tmp, &elevator.pets_on_elevator, list) { 
-        list_del(&pet->list); 
-        kfree(pet);
-    }
-    for (i = 0; i < NUM_FLOORS; i++)
-        list_for_each_entry_safe(pet, tmp, &floors[i].waiting_pets, list) { 
-            list_del(&pet->list); 
-            kfree(pet);
-        }
+    free_all_pets();
     mutex_unlock(&elevator_mutex);
 
     printk(KERN_INFO "elevator: exit\n");
 }
 
 module_init(elevator_init);
-module_exit(elevator_exit);
\ No newline at end of file
+module_exit(elevator_exit);
+
+#ifdef ELEVATOR_KUNIT
+#include "../tests/kunit/elevator_kunit.c"
+#endif
\ No newline at end of file
@@ -0,0 +1,70 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include "wrappers.h"
+
+// Must match struct elevator_trace_rec in src/elevator.c
+struct trace_rec {
+	uint64_t timestamp_ns;
+	uint8_t start_floor;
+	uint8_t destination_floor;
+	uint8_t type;
+	uint8_t reserved;
+} __attribute__((packed));
+
+// Sleeps until `offset_ns` nanoseconds after `base`
+void sleep_until(const struct timespec *base, uint64_t offset_ns) {
+	struct timespec when;
+
+	when.tv_sec = base->tv_sec + offset_ns / 1000000000ULL;
+	when.tv_nsec = base->tv_nsec + offset_ns % 1000000000ULL;
+	if (when.tv_nsec >= 1000000000L) {
+		when.tv_sec += 1;
+		when.tv_nsec -= 1000000000L;
+	}
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &when, NULL) != 0)
+		;
+}
+
+int main(int argc, char **argv) {
+	FILE *fp;
+	struct trace_rec rec;
+	struct timespec base;
+	uint64_t first_ts = 0;
+	double speedup = 1.0;
+	int count = 0;
+
+	if (argc != 2 && argc != 3) {
+		printf("wrong number of args. replay.x trace_file [speedup]\n");
+		return -1;
+	}
+	if (argc == 3 && (sscanf(argv[2], "%lf", &speedup) != 1 || speedup < 0)) {
+		printf("speedup must be a non-negative number (0 replays as fast as possible)\n");
+		return -1;
+	}
+
+	fp = fopen(argv[1], "rb");
+	if (!fp) {
+		perror(argv[1]);
+		return -1;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &base);
+	while (fread(&rec, sizeof(rec), 1, fp) == 1) {
+		if (count == 0)
+			first_ts = rec.timestamp_ns;
+
+		if (speedup > 0)
+			sleep_until(&base, (uint64_t)((rec.timestamp_ns - first_ts) / speedup));
+
+		long ret = issue_request(rec.start_floor, rec.destination_floor, rec.type);
+		printf("Issue (%d, %d, %d) returned %ld\n",
+		       rec.start_floor, rec.destination_floor, rec.type, ret);
+		count++;
+	}
+
+	fclose(fp);
+	printf("Replayed %d requests\n", count);
+	return 0;
+}
@@ -0,0 +1,839 @@
+// KUnit suite for the pet elevator
+//
+// This file is #included at the bottom of src/elevator.c when the module is
+// built with KUNIT=1, so it can reach the static helpers directly. The
+// elevator thread is not started in that build, so the tests own the state.
+#include <kunit/test.h>
+
+// Queue depth used by the microbenchmarks
+#define BENCH_DEPTH 10000
+
+// Workload for the dispatch simulation: SIM_BURST requests every SIM_BURST_EVERY steps
+#define SIM_PETS 2000
+#define SIM_BURST 8
+#define SIM_BURST_EVERY 10
+#define SIM_MAX_STEPS 1000000
+
+// Per-operation budgets for the microbenchmarks, roughly 10x what they take on a
+// desktop machine, so only a real slowdown (e.g. a scan of the whole queue) fails
+#define BUDGET_ENQUEUE_NS 1000
+#define BUDGET_LOAD_UNLOAD_NS 3000
+#define BUDGET_DECISION_NS 500
+
+// Scales every budget, in percent (0 = report only)
+static unsigned int bench_budget_pct = 100;
+module_param(bench_budget_pct, uint, 0644);
+MODULE_PARM_DESC(bench_budget_pct, "Scale the KUnit microbenchmark budgets, in percent (0 = report only)");
+
+// Puts the elevator back to an empty IDLE car on floor 1
+static int elevator_test_init(struct kunit *test) {
+    mutex_lock(&elevator_mutex);
+    free_all_pets();
+    elevator.state = IDLE;
+    elevator.direction = IDLE;
+    elevator.current_floor = 1;
+    elevator.should_stop = false;
+    collective = true;
+    total_pets_serviced = 0;
+    mutex_unlock(&elevator_mutex);
+    return 0;
+}
+
+static void elevator_test_exit(struct kunit *test) {
+    mutex_lock(&elevator_mutex);
+    free_all_pets();
+    elevator.state = OFFLINE;
+    elevator.direction = IDLE;
+    elevator.current_floor = 1;
+    elevator.should_stop = false;
+    collective = true;
+    total_pets_serviced = 0;
+    mutex_unlock(&elevator_mutex);
+}
+
+// Queues a pet on its start floor the same way issue_request does, without the log line
+static void test_queue_pet(struct kunit *test, int start, int dest, int type) {
+    Pet pet = { .type = type, .start_floor = start, .destination_floor = dest };
+
+    KUNIT_ASSERT_EQ(test, add_pet_to_floor(start - 1, &pet), 0);
+}
+
+// Puts a pet straight onto the elevator
+static void test_board_pet(struct kunit *test, int dest, int type) {
+    Pet pet = { .type = type, .start_floor = elevator.current_floor, .destination_floor = dest };
+
+    KUNIT_ASSERT_TRUE(test, elevator.num_pets < MAX_CAPACITY);
+    elevator.pets_on_elevator[elevator.num_pets++] = pet;
+    elevator.current_weight += pet_weight(&pet);
+}
+
+// Shows up to `records` records from *pos, the way one read() of the proc file does
+static void test_read_proc(struct seq_file *m, loff_t *pos, int records) {
+    void *v = elevator_seq_start(m, pos);
+
+    for (; v && records > 0; records--) {
+        elevator_seq_show(m, v);
+        v = elevator_seq_next(m, v, pos);
+    }
+    elevator_seq_stop(m, v);
+}
+
+// Renders every record of a /proc view into a test-owned buffer
+static char *test_render_proc(struct kunit *test, bool summary) {
+    ProcCursor c = { .summary = summary };
+    struct seq_file m = { .size = 8192 };
+    loff_t pos = 0;
+
+    m.buf = kunit_kzalloc(test, m.size, GFP_KERNEL);
+    KUNIT_ASSERT_NOT_ERR_OR_NULL(test, m.buf);
+    m.private = &c;
+    test_read_proc(&m, &pos, INT_MAX);
+    KUNIT_ASSERT_TRUE(test, m.count < m.size);
+    m.buf[m.count] = '\0';
+    return m.buf;
+}
+
+// Counts the lines in a rendered view
+static int test_count_lines(const char *buf) {
+    int lines = 0;
+    for (; *buf; buf++)
+        if (*buf == '\n') lines++;
+    return lines;
+}
+
+// Stands in for the elevator thread's sleeps
+static void test_pause(unsigned int seconds) {
+}
+
+// Runs the elevator thread's loop without sleeping until a fixed bursty workload is
+// delivered, returning the number of floors travelled and counting stops
+static u64 test_simulate(struct kunit *test, bool use_collective, u64 *stops) {
+    u32 seed = 2024;
+    u64 moves = 0;
+    int step, i, issued = 0;
+    int start, dest, done;
+
+    collective = use_collective;
+    *stops = 0;
+    for (step = 0; step < SIM_MAX_STEPS; step++) {
+        if (issued == SIM_PETS && total_pets_waiting == 0 && elevator.num_pets == 0)
+            break;
+
+        if (step % SIM_BURST_EVERY == 0) {
+            for (i = 0; i < SIM_BURST && issued < SIM_PETS; i++, issued++) {
+                seed = seed * 1103515245 + 12345;
+                start = 1 + (seed >> 16) % NUM_FLOORS;
+                dest = 1 + (start + (seed >> 8) % (NUM_FLOORS - 1)) % NUM_FLOORS;
+                test_queue_pet(test, start, dest, (seed >> 4) % 4);
+            }
+        }
+
+        done = elevator_step(test_pause);
+        if (done & STEP_LOADED)
+            (*stops)++;
+        if (done & STEP_MOVED)
+            moves++;
+    }
+
+    KUNIT_EXPECT_EQ(test, total_pets_serviced, SIM_PETS);
+    return moves;
+}
+
+// Reports a benchmark result and checks it against its scaled budget
+static void bench_report(struct kunit *test, const char *name, u64 elapsed_ns, u64 ops, u64 budget_ns) {
+    u64 per_op = ops ? elapsed_ns / ops : 0;
+    u64 limit = budget_ns * bench_budget_pct / 100;
+
+    kunit_info(test, "%s: %llu ops in %llu ns (%llu ns/op, budget %llu ns/op)\n", name,
+               (unsigned long long)ops, (unsigned long long)elapsed_ns,
+               (unsigned long long)per_op, (unsigned long long)limit);
+    if (bench_budget_pct)
+        KUNIT_EXPECT_LE_MSG(test, per_op, limit, "%s over budget", name);
+}
+
+// Correctness: can_board_pet
+
+static void can_board_pet_empty_test(struct kunit *test) {
+    test_queue_pet(test, 1, 2, PET_DACHSHUND);
+    KUNIT_EXPECT_TRUE(test, can_board_pet(&floor_run(&floors[0].calls[HALL_UP], 0)->pet));
+}
+
+static void can_board_pet_capacity_test(struct kunit *test) {
+    int i;
+
+    for (i = 0; i < MAX_CAPACITY; i++)
+        test_board_pet(test, 3, PET_CHIHUAHUA);
+    test_queue_pet(test, 1, 2, PET_CHIHUAHUA);
+    KUNIT_EXPECT_FALSE(test, can_board_pet(&floor_run(&floors[0].calls[HALL_UP], 0)->pet));
+}
+
+static void can_board_pet_weight_test(struct kunit *test) {
+    // 16 + 16 + 14 = 46 lbs on board, 4 lbs left
+    test_board_pet(test, 3, PET_DACHSHUND);
+    test_board_pet(test, 3, PET_DACHSHUND);
+    test_board_pet(test, 3, PET_PUG);
+
+    test_queue_pet(test, 1, 2, PET_CHIHUAHUA);
+    test_queue_pet(test, 1, 2, PET_PUGHUAHUA);
+    KUNIT_EXPECT_TRUE(test, can_board_pet(&floor_run(&floors[0].calls[HALL_UP], 0)->pet));
+    KUNIT_EXPECT_FALSE(test, can_board_pet(&floor_run(&floors[0].calls[HALL_UP], 1)->pet));
+}
+
+// Correctness: load_pets
+
+static void load_pets_fifo_test(struct kunit *test) {
+    test_queue_pet(test, 1, 3, PET_PUG);
+    test_queue_pet(test, 1, 4, PET_CHIHUAHUA);
+    test_queue_pet(test, 2, 5, PET_PUG);
+
+    load_pets();
+
+    KUNIT_EXPECT_EQ(test, elevator.num_pets, 2);
+    KUNIT_EXPECT_EQ(test, elevator.current_weight, 17);
+    KUNIT_EXPECT_EQ(test, floors[0].num_waiting, 0);
+    KUNIT_EXPECT_EQ(test, floors[0].waiting_weight, 0);
+    KUNIT_EXPECT_EQ(test, floors[1].num_waiting, 1);
+    KUNIT_EXPECT_EQ(test, total_pets_waiting, 1);
+    KUNIT_EXPECT_EQ(test, elevator.pets_on_elevator[0].type, PET_PUG);
+}
+
+static void load_pets_head_of_line_test(struct kunit *test) {
+    // The dachshund does not fit, so the chihuahua behind it has to wait too
+    test_board_pet(test, 5, PET_DACHSHUND);
+    test_board_pet(test, 5, PET_DACHSHUND);
+    test_board_pet(test, 5, PET_PUG);
+    test_queue_pet(test, 1, 2, PET_DACHSHUND);
+    test_queue_pet(test, 1, 2, PET_CHIHUAHUA);
+
+    load_pets();
+
+    KUNIT_EXPECT_EQ(test, elevator.num_pets, 3);
+    KUNIT_EXPECT_EQ(test, floors[0].num_waiting, 2);
+}
+
+static void load_pets_capacity_test(struct kunit *test) {
+    int i;
+
+    for (i = 0; i < MAX_CAPACITY + 2; i++)
+        test_queue_pet(test, 1, 2, PET_CHIHUAHUA);
+
+    load_pets();
+
+    KUNIT_EXPECT_EQ(test, elevator.num_pets, MAX_CAPACITY);
+    KUNIT_EXPECT_EQ(test, floors[0].num_waiting, 2);
+    KUNIT_EXPECT_EQ(test, total_pets_waiting, 2);
+}
+
+static void load_pets_stopping_test(struct kunit *test) {
+    test_queue_pet(test, 1, 2, PET_CHIHUAHUA);
+    elevator.should_stop = true;
+
+    load_pets();
+
+    KUNIT_EXPECT_EQ(test, elevator.num_pets, 0);
+    KUNIT_EXPECT_EQ(test, floors[0].num_waiting, 1);
+}
+
+static void load_pets_ring_wrap_test(struct kunit *test) {
+    // Grow the ring while the queue wraps around its end, FIFO order must survive
+    int i, next = 0;
+
+    for (i = 0; i < FLOOR_RING_MIN; i++)
+        test_queue_pet(test, 1, 2 + i % 4, i % 4);
+    load_pets();
+    for (i = FLOOR_RING_MIN; i < 3 * FLOOR_RING_MIN; i++)
+        test_queue_pet(test, 1, 2 + i % 4, i % 4);
+
+    KUNIT_EXPECT_EQ(test, floors[0].calls[HALL_UP].capacity, 4u * FLOOR_RING_MIN);
+    KUNIT_EXPECT_EQ(test, floors[0].calls[HALL_UP].num_runs, (unsigned int)floors[0].num_waiting);
+    KUNIT_EXPECT_EQ(test, floors[0].num_waiting, 3 * FLOOR_RING_MIN - elevator.num_pets);
+
+    // Empty the car after every load and check pets come out in the order they were queued
+    while (total_pets_waiting > 0 || elevator.num_pets > 0) {
+        for (i = 0; i < elevator.num_pets; i++, next++) {
+            KUNIT_EXPECT_EQ(test, elevator.pets_on_elevator[i].type, next % 4);
+            KUNIT_EXPECT_EQ(test, elevator.pets_on_elevator[i].destination_floor, 2 + next % 4);
+        }
+        elevator.num_pets = 0;
+        elevator.current_weight = 0;
+        load_pets();
+    }
+    KUNIT_EXPECT_EQ(test, next, 3 * FLOOR_RING_MIN);
+    KUNIT_EXPECT_TRUE(test, floors[0].calls[HALL_UP].ring == NULL);
+}
+
+static void load_pets_ring_shrink_test(struct kunit *test) {
+    // A burst of distinct runs grows the ring, draining it gives the memory back
+    HallQueue *queue = &floors[0].calls[HALL_UP];
+    int i;
+
+    for (i = 0; i < 8 * FLOOR_RING_MIN; i++)
+        test_queue_pet(test, 1, 2 + i % 4, i % 4);
+    KUNIT_EXPECT_EQ(test, queue->capacity, 8u * FLOOR_RING_MIN);
+
+    while (total_pets_waiting > 0) {
+        elevator.num_pets = 0;
+        elevator.current_weight = 0;
+        load_pets();
+        if (queue->num_runs > 0)
+            KUNIT_EXPECT_TRUE(test, queue->capacity == FLOOR_RING_MIN ||
+                                    queue->capacity < 4 * queue->num_runs);
+    }
+    KUNIT_EXPECT_TRUE(test, queue->ring == NULL);
+    KUNIT_EXPECT_EQ(test, queue->capacity, 0u);
+
+    // The queue grows again from scratch
+    test_queue_pet(test, 1, 2, PET_PUG);
+    KUNIT_EXPECT_EQ(test, queue->capacity, (unsigned int)FLOOR_RING_MIN);
+    KUNIT_EXPECT_EQ(test, queue->num_runs, 1u);
+}
+
+static void load_pets_coalesce_test(struct kunit *test) {
+    int i;
+
+    // Only consecutive identical requests share a run, so FIFO order is kept
+    for (i = 0; i < 10; i++)
+        test_queue_pet(test, 1, 2, PET_CHIHUAHUA);
+    test_queue_pet(test, 1, 3, PET_CHIHUAHUA);
+    test_queue_pet(test, 1, 2, PET_PUG);
+    test_queue_pet(test, 1, 2, PET_CHIHUAHUA);
+
+    KUNIT_EXPECT_EQ(test, floors[0].calls[HALL_UP].num_runs, 4u);
+    KUNIT_EXPECT_EQ(test, floors[0].num_waiting, 13);
+    KUNIT_EXPECT_EQ(test, floor_run(&floors[0].calls[HALL_UP], 0)->count, 10);
+
+    // Capacity splits the first run
+    load_pets();
+    KUNIT_EXPECT_EQ(test, elevator.num_pets, MAX_CAPACITY);
+    KUNIT_EXPECT_EQ(test, floors[0].calls[HALL_UP].num_runs, 4u);
+    KUNIT_EXPECT_EQ(test, floor_run(&floors[0].calls[HALL_UP], 0)->count, 5);
+    KUNIT_EXPECT_EQ(test, floors[0].num_waiting, 8);
+    KUNIT_EXPECT_EQ(test, floors[0].waiting_weight, 6 * 3 + 14 + 3);
+}
+
+static void load_pets_coalesce_weight_test(struct kunit *test) {
+    int i;
+
+    // Weight splits a run: three dachshunds make 48 lbs
+    for (i = 0; i < 10; i++)
+        test_queue_pet(test, 2, 1, PET_DACHSHUND);
+    test_queue_pet(test, 2, 1, PET_CHIHUAHUA);
+    elevator.current_floor = 2;
+
+    load_pets();
+    KUNIT_EXPECT_EQ(test, elevator.num_pets, 3);
+    KUNIT_EXPECT_EQ(test, elevator.current_weight, 48);
+    KUNIT_EXPECT_EQ(test, floor_run(&floors[1].calls[HALL_DOWN], 0)->count, 7);
+    KUNIT_EXPECT_EQ(test, total_pets_waiting, 8);
+}
+
+static void load_pets_run_limit_test(struct kunit *test) {
+    int i;
+
+    // A run's counter saturates and the next identical pet starts a new run
+    for (i = 0; i <= U16_MAX; i++)
+        test_queue_pet(test, 1, 5, PET_CHIHUAHUA);
+
+    KUNIT_EXPECT_EQ(test, floors[0].calls[HALL_UP].num_runs, 2u);
+    KUNIT_EXPECT_EQ(test, floor_run(&floors[0].calls[HALL_UP], 0)->count, U16_MAX);
+    KUNIT_EXPECT_EQ(test, floor_run(&floors[0].calls[HALL_UP], 1)->count, 1);
+}
+
+// Correctness: hall call queues
+
+static void hall_call_queues_test(struct kunit *test) {
+    test_queue_pet(test, 3, 5, PET_PUG);
+    test_queue_pet(test, 3, 1, PET_PUG);
+    test_queue_pet(test, 3, 4, PET_PUG);
+
+    KUNIT_EXPECT_EQ(test, floors[2].calls[HALL_UP].num_waiting, 2);
+    KUNIT_EXPECT_EQ(test, floors[2].calls[HALL_DOWN].num_waiting, 1);
+    KUNIT_EXPECT_EQ(test, floors[2].num_waiting, 3);
+    KUNIT_EXPECT_EQ(test, floors[2].waiting_weight, 3 * 14);
+}
+
+static void collective_sweep_test(struct kunit *test) {
+    // Heading up, the car boards the up call and leaves the down call for later
+    elevator.current_floor = 3;
+    elevator.direction = UP;
+    test_board_pet(test, 5, PET_CHIHUAHUA);
+    test_queue_pet(test, 3, 1, PET_PUG);
+    test_queue_pet(test, 3, 4, PET_DACHSHUND);
+
+    KUNIT_EXPECT_TRUE(test, has_waiting_pets());
+    load_pets();
+
+    KUNIT_EXPECT_EQ(test, elevator.num_pets, 2);
+    KUNIT_EXPECT_EQ(test, elevator.pets_on_elevator[1].type, PET_DACHSHUND);
+    KUNIT_EXPECT_EQ(test, floors[2].calls[HALL_DOWN].num_waiting, 1);
+    KUNIT_EXPECT_FALSE(test, has_waiting_pets());
+    KUNIT_EXPECT_EQ(test, elevator.direction, UP);
+}
+
+static void collective_pass_by_test(struct kunit *test) {
+    // A car sweeping up does not stop for a down call it will come back for
+    elevator.current_floor = 2;
+    elevator.direction = UP;
+    test_board_pet(test, 5, PET_CHIHUAHUA);
+    test_queue_pet(test, 2, 1, PET_PUG);
+
+    KUNIT_EXPECT_FALSE(test, needs_to_unload() || has_waiting_pets());
+    set_next_state();
+    KUNIT_EXPECT_EQ(test, elevator.state, UP);
+}
+
+static void collective_reverse_test(struct kunit *test) {
+    // Nothing needs the car higher up, so it turns around and takes the down call
+    elevator.current_floor = 3;
+    elevator.direction = UP;
+    test_queue_pet(test, 3, 1, PET_PUG);
+    test_queue_pet(test, 1, 2, PET_PUG);
+
+    KUNIT_EXPECT_EQ(test, boarding_direction(), DOWN);
+    KUNIT_EXPECT_TRUE(test, has_waiting_pets());
+    load_pets();
+
+    KUNIT_EXPECT_EQ(test, elevator.num_pets, 1);
+    KUNIT_EXPECT_EQ(test, elevator.direction, DOWN);
+    set_next_state();
+    KUNIT_EXPECT_EQ(test, elevator.state, DOWN);
+}
+
+static void collective_pet_above_test(struct kunit *test) {
+    // A down call above keeps an empty car going up
+    elevator.current_floor = 3;
+    elevator.direction = UP;
+    test_queue_pet(test, 3, 1, PET_PUG);
+    test_queue_pet(test, 5, 4, PET_PUG);
+
+    KUNIT_EXPECT_EQ(test, boarding_direction(), UP);
+    KUNIT_EXPECT_FALSE(test, has_waiting_pets());
+    set_next_state();
+    KUNIT_EXPECT_EQ(test, elevator.state, UP);
+}
+
+static void non_collective_test(struct kunit *test) {
+    // With collective control off, everyone at the floor boards, the car's direction first
+    collective = false;
+    elevator.current_floor = 3;
+    elevator.direction = UP;
+    test_queue_pet(test, 3, 1, PET_PUG);
+    test_queue_pet(test, 3, 4, PET_DACHSHUND);
+
+    KUNIT_EXPECT_TRUE(test, has_waiting_pets());
+    load_pets();
+
+    KUNIT_EXPECT_EQ(test, elevator.num_pets, 2);
+    KUNIT_EXPECT_EQ(test, elevator.pets_on_elevator[0].type, PET_DACHSHUND);
+    KUNIT_EXPECT_EQ(test, floors[2].num_waiting, 0);
+}
+
+// Correctness: unload_pets
+
+static void unload_pets_test(struct kunit *test) {
+    test_board_pet(test, 3, PET_PUG);
+    test_board_pet(test, 4, PET_CHIHUAHUA);
+    test_board_pet(test, 3, PET_DACHSHUND);
+    elevator.current_floor = 3;
+
+    KUNIT_EXPECT_TRUE(test, needs_to_unload());
+    unload_pets();
+
+    KUNIT_EXPECT_EQ(test, elevator.num_pets, 1);
+    KUNIT_EXPECT_EQ(test, elevator.current_weight, 3);
+    KUNIT_EXPECT_EQ(test, total_pets_serviced, 2);
+    KUNIT_EXPECT_FALSE(test, needs_to_unload());
+}
+
+static void unload_pets_none_test(struct kunit *test) {
+    test_board_pet(test, 5, PET_PUG);
+    elevator.current_floor = 2;
+
+    unload_pets();
+
+    KUNIT_EXPECT_EQ(test, elevator.num_pets, 1);
+    KUNIT_EXPECT_EQ(test, total_pets_serviced, 0);
+}
+
+// Correctness: determine_next_direction
+
+static void direction_idle_test(struct kunit *test) {
+    KUNIT_EXPECT_EQ(test, determine_next_direction(), IDLE);
+}
+
+static void direction_offline_test(struct kunit *test) {
+    test_queue_pet(test, 3, 1, PET_PUG);
+    elevator.should_stop = true;
+    KUNIT_EXPECT_EQ(test, determine_next_direction(), OFFLINE);
+}
+
+static void direction_stop_delivers_onboard_test(struct kunit *test) {
+    test_board_pet(test, 4, PET_PUG);
+    elevator.should_stop = true;
+    KUNIT_EXPECT_EQ(test, determine_next_direction(), UP);
+}
+
+static void direction_waiting_test(struct kunit *test) {
+    elevator.current_floor = 3;
+    test_queue_pet(test, 1, 2, PET_PUG);
+    KUNIT_EXPECT_EQ(test, determine_next_direction(), DOWN);
+
+    test_queue_pet(test, 5, 1, PET_PUG);
+    KUNIT_EXPECT_EQ(test, determine_next_direction(), UP);
+}
+
+static void direction_keeps_sweep_test(struct kunit *test) {
+    // Heading down with a pet waiting below, a pet waiting above must not turn the car
+    elevator.current_floor = 3;
+    elevator.state = DOWN;
+    elevator.direction = DOWN;
+    test_queue_pet(test, 5, 1, PET_PUG);
+    test_queue_pet(test, 1, 2, PET_PUG);
+    KUNIT_EXPECT_EQ(test, determine_next_direction(), DOWN);
+}
+
+static void direction_onboard_first_test(struct kunit *test) {
+    // With nothing above, an UP car turns for its passengers until a pet waits above
+    elevator.current_floor = 3;
+    elevator.state = UP;
+    elevator.direction = UP;
+    test_board_pet(test, 1, PET_PUG);
+    KUNIT_EXPECT_EQ(test, determine_next_direction(), DOWN);
+
+    test_queue_pet(test, 5, 1, PET_PUG);
+    KUNIT_EXPECT_EQ(test, determine_next_direction(), UP);
+}
+
+static void direction_full_test(struct kunit *test) {
+    // A full car ignores waiting pets and follows its passengers
+    int i;
+
+    elevator.current_floor = 3;
+    elevator.state = UP;
+    elevator.direction = UP;
+    for (i = 0; i < MAX_CAPACITY; i++)
+        test_board_pet(test, 1, PET_CHIHUAHUA);
+    test_queue_pet(test, 5, 1, PET_PUG);
+    KUNIT_EXPECT_EQ(test, determine_next_direction(), DOWN);
+}
+
+// Correctness: syscall entry points
+
+static void issue_request_validation_test(struct kunit *test) {
+    KUNIT_EXPECT_EQ(test, issue_request_impl(0, 2, PET_PUG), 1);
+    KUNIT_EXPECT_EQ(test, issue_request_impl(1, NUM_FLOORS + 1, PET_PUG), 1);
+    KUNIT_EXPECT_EQ(test, issue_request_impl(2, 2, PET_PUG), 1);
+    KUNIT_EXPECT_EQ(test, issue_request_impl(1, 2, 4), 1);
+    KUNIT_EXPECT_EQ(test, total_pets_waiting, 0);
+
+    KUNIT_EXPECT_EQ(test, issue_request_impl(1, 2, PET_PUG), 0);
+    KUNIT_EXPECT_EQ(test, floors[0].num_waiting, 1);
+    KUNIT_EXPECT_EQ(test, floors[0].waiting_weight, pet_weights[PET_PUG]);
+}
+
+static void start_stop_test(struct kunit *test) {
+    elevator.state = OFFLINE;
+    KUNIT_EXPECT_EQ(test, stop_elevator_impl(), 1);
+    KUNIT_EXPECT_EQ(test, start_elevator_impl(), 0);
+    KUNIT_EXPECT_EQ(test, start_elevator_impl(), 1);
+    KUNIT_EXPECT_EQ(test, stop_elevator_impl(), 0);
+    KUNIT_EXPECT_EQ(test, stop_elevator_impl(), 1);
+}
+
+// Correctness: /proc iterator
+
+static void proc_seek_test(struct kunit *test) {
+    ProcCursor c = { .summary = false };
+    int i;
+
+    // Header, floors 5..2, three chunks for floor 1, totals
+    for (i = 0; i < 2 * PROC_CHUNK_PETS + 2; i++)
+        test_queue_pet(test, 1, 2, PET_CHIHUAHUA);
+
+    KUNIT_EXPECT_TRUE(test, elevator_seq_seek(&c, 0) == &c);
+    KUNIT_EXPECT_EQ(test, c.floor, NUM_FLOORS);
+    KUNIT_EXPECT_TRUE(test, elevator_seq_seek(&c, 1) == &c);
+    KUNIT_EXPECT_EQ(test, c.floor, NUM_FLOORS - 1);
+    KUNIT_EXPECT_TRUE(test, elevator_seq_seek(&c, 7) == &c);
+    KUNIT_EXPECT_EQ(test, c.floor, 0);
+    KUNIT_EXPECT_EQ(test, c.chunk, 2u);
+    KUNIT_EXPECT_EQ(test, c.run, 0u);
+    KUNIT_EXPECT_EQ(test, c.offset, 2u * PROC_CHUNK_PETS);
+    KUNIT_EXPECT_TRUE(test, elevator_seq_seek(&c, 8) == &c);
+    KUNIT_EXPECT_EQ(test, c.floor, -1);
+    KUNIT_EXPECT_TRUE(test, elevator_seq_seek(&c, 9) == NULL);
+
+    c.summary = true;
+    KUNIT_EXPECT_TRUE(test, elevator_seq_seek(&c, 5) == &c);
+    KUNIT_EXPECT_EQ(test, c.floor, 0);
+    KUNIT_EXPECT_TRUE(test, elevator_seq_seek(&c, 6) == &c);
+    KUNIT_EXPECT_EQ(test, c.floor, -1);
+    KUNIT_EXPECT_TRUE(test, elevator_seq_seek(&c, 7) == NULL);
+}
+
+static void proc_show_test(struct kunit *test) {
+    char *buf;
+    int i;
+
+    for (i = 0; i < PROC_CHUNK_PETS + 1; i++)
+        test_queue_pet(test, 1, 2, PET_CHIHUAHUA);
+    test_queue_pet(test, 3, 1, PET_DACHSHUND);
+    test_queue_pet(test, 5, 2, PET_PUG);
+    test_queue_pet(test, 5, 2, PET_PUG);
+    test_queue_pet(test, 5, 1, PET_PUGHUAHUA);
+    test_board_pet(test, 4, PET_PUG);
+
+    // Chunks of a floor join into one line, same layout as before
+    buf = test_render_proc(test, false);
+    KUNIT_EXPECT_EQ(test, test_count_lines(buf), 4 + NUM_FLOORS + 3);
+    KUNIT_EXPECT_TRUE(test, strstr(buf, "Elevator status: P4 \n") != NULL);
+    KUNIT_EXPECT_TRUE(test, strstr(buf, "[ ] Floor 5: 3 P2 P2 H1 \n") != NULL);
+    KUNIT_EXPECT_TRUE(test, strstr(buf, "[ ] Floor 3: 1 D1 \n") != NULL);
+    KUNIT_EXPECT_TRUE(test, strstr(buf, "[*] Floor 1: 65 C2 C2 ") != NULL);
+    KUNIT_EXPECT_TRUE(test, strstr(buf, "Number of pets waiting: 69\n") != NULL);
+
+    buf = test_render_proc(test, true);
+    KUNIT_EXPECT_EQ(test, test_count_lines(buf), 4 + NUM_FLOORS + 3);
+    KUNIT_EXPECT_TRUE(test, strstr(buf, "[ ] Floor 3: 1 \n") != NULL);
+    KUNIT_EXPECT_TRUE(test, strstr(buf, "[*] Floor 1: 65 \n") != NULL);
+}
+
+static void proc_partial_read_test(struct kunit *test) {
+    ProcCursor c = { .summary = false };
+    struct seq_file m = { .size = 8192 };
+    loff_t pos = 0;
+    int i;
+
+    for (i = 0; i < 200; i++)
+        test_queue_pet(test, 2, 3, PET_CHIHUAHUA);
+    for (i = 0; i < 3; i++)
+        test_queue_pet(test, 1, 4, PET_PUG);
+    m.buf = kunit_kzalloc(test, m.size, GFP_KERNEL);
+    KUNIT_ASSERT_NOT_ERR_OR_NULL(test, m.buf);
+    m.private = &c;
+
+    // First read stops after two of floor 2's four chunks, then half of its queue boards
+    test_read_proc(&m, &pos, 6);
+    elevator.current_floor = 2;
+    while (floors[1].num_waiting > 100) {
+        board_from_queue(&floors[1], &floors[1].calls[HALL_UP]);
+        elevator.num_pets = 0;
+        elevator.current_weight = 0;
+    }
+    test_read_proc(&m, &pos, INT_MAX);
+    KUNIT_ASSERT_TRUE(test, m.count < m.size);
+    m.buf[m.count] = '\0';
+
+    // Every floor still gets its own line
+    KUNIT_EXPECT_EQ(test, test_count_lines(m.buf), 4 + NUM_FLOORS + 3);
+    KUNIT_EXPECT_TRUE(test, strstr(m.buf, " [") == NULL);
+    KUNIT_EXPECT_TRUE(test, strstr(m.buf, "[ ] Floor 2: 200 C3 ") != NULL);
+    KUNIT_EXPECT_TRUE(test, strstr(m.buf, "[ ] Floor 1: 3 P4 P4 P4 \n") != NULL);
+    KUNIT_EXPECT_TRUE(test, strstr(m.buf, "Number of pets waiting: 103\n") != NULL);
+}
+
+static void proc_resume_test(struct kunit *test) {
+    ProcCursor c = { .summary = false };
+    struct seq_file m = { .size = 8192 };
+    loff_t pos = 0;
+    char *whole;
+    int i;
+
+    // Alternating types so nothing coalesces and a floor has a run per pet
+    for (i = 0; i < 3 * PROC_CHUNK_PETS; i++)
+        test_queue_pet(test, 1, 2 + i % 2, i % 2 ? PET_PUG : PET_CHIHUAHUA);
+    for (i = 0; i < PROC_CHUNK_PETS; i++)
+        test_queue_pet(test, 4, 1 + i % 3, PET_DACHSHUND);
+    whole = test_render_proc(test, false);
+
+    // One record per read resumes from the cursor and gives the same text
+    m.buf = kunit_kzalloc(test, m.size, GFP_KERNEL);
+    KUNIT_ASSERT_NOT_ERR_OR_NULL(test, m.buf);
+    m.private = &c;
+    for (i = 0; i < 20; i++) {
+        test_read_proc(&m, &pos, 1);
+        KUNIT_EXPECT_TRUE(test, c.pos == pos || c.pos == -1);
+    }
+    KUNIT_ASSERT_TRUE(test, m.count < m.size);
+    m.buf[m.count] = '\0';
+    KUNIT_EXPECT_STREQ(test, m.buf, whole);
+}
+
+// Correctness: lock statistics
+
+static void lockstat_bucket_test(struct kunit *test) {
+    KUNIT_EXPECT_EQ(test, lockstat_bucket(0), 0);
+    KUNIT_EXPECT_EQ(test, lockstat_bucket(999), 0);
+    KUNIT_EXPECT_EQ(test, lockstat_bucket(1000), 1);
+    KUNIT_EXPECT_EQ(test, lockstat_bucket(3999), 2);
+    KUNIT_EXPECT_EQ(test, lockstat_bucket(4000), 3);
+    KUNIT_EXPECT_EQ(test, lockstat_bucket(U64_MAX), LOCKSTAT_BUCKETS - 1);
+}
+
+static void lockstat_site_test(struct kunit *test) {
+    LockStat *issue = &lock_stats[LOCK_SITE_ISSUE];
+    u64 acquisitions = issue->acquisitions;
+    u32 holds = 0;
+    int b;
+
+    KUNIT_EXPECT_EQ(test, issue_request_impl(1, 2, PET_PUG), 0);
+    KUNIT_EXPECT_EQ(test, issue_request_impl(0, 2, PET_PUG), 1);
+
+    // Rejected requests never take the lock
+    KUNIT_EXPECT_EQ(test, issue->acquisitions, acquisitions + 1);
+    for (b = 0; b < LOCKSTAT_BUCKETS; b++)
+        holds += issue->hold_hist[b];
+    KUNIT_EXPECT_EQ(test, (u64)holds, issue->acquisitions);
+    KUNIT_EXPECT_FALSE(test, mutex_is_locked(&elevator_mutex));
+}
+
+// Microbenchmarks
+
+static void bench_queue_test(struct kunit *test) {
+    u64 start;
+    int i;
+
+    start = ktime_get_ns();
+    for (i = 0; i < BENCH_DEPTH; i++)
+        test_queue_pet(test, 1 + i % NUM_FLOORS, 1 + (i + 1) % NUM_FLOORS, i % 4);
+    bench_report(test, "enqueue", ktime_get_ns() - start, BENCH_DEPTH, BUDGET_ENQUEUE_NS);
+
+    KUNIT_EXPECT_EQ(test, total_pets_waiting, BENCH_DEPTH);
+}
+
+static void bench_load_unload_test(struct kunit *test) {
+    u64 start, ops = 0;
+    int i;
+
+    // Everyone waits on floor 1 for floor 2, drain the queue one car at a time
+    for (i = 0; i < BENCH_DEPTH; i++)
+        test_queue_pet(test, 1, 2, i % 4);
+
+    start = ktime_get_ns();
+    while (total_pets_waiting > 0) {
+        elevator.current_floor = 1;
+        load_pets();
+        elevator.current_floor = 2;
+        unload_pets();
+        ops++;
+    }
+    bench_report(test, "load_pets+unload_pets", ktime_get_ns() - start, ops, BUDGET_LOAD_UNLOAD_NS);
+
+    KUNIT_EXPECT_EQ(test, total_pets_serviced, BENCH_DEPTH);
+}
+
+static void bench_load_unload_runs_test(struct kunit *test) {
+    u64 start, ops = 0;
+    int i;
+
+    // Same drain as above, but every request is identical so the floor holds a single run
+    for (i = 0; i < BENCH_DEPTH; i++)
+        test_queue_pet(test, 1, 2, PET_CHIHUAHUA);
+    KUNIT_EXPECT_EQ(test, floors[0].calls[HALL_UP].num_runs, 1u);
+
+    start = ktime_get_ns();
+    while (total_pets_waiting > 0) {
+        elevator.current_floor = 1;
+        load_pets();
+        elevator.current_floor = 2;
+        unload_pets();
+        ops++;
+    }
+    bench_report(test, "load_pets+unload_pets (coalesced)", ktime_get_ns() - start, ops, BUDGET_LOAD_UNLOAD_NS);
+
+    KUNIT_EXPECT_EQ(test, total_pets_serviced, BENCH_DEPTH);
+}
+
+static void bench_decision_test(struct kunit *test) {
+    u64 start;
+    ElevatorState next = IDLE;
+    int i;
+
+    // Deep queues on the far floors, nothing nearby
+    for (i = 0; i < BENCH_DEPTH; i++)
+        test_queue_pet(test, (i & 1) ? 1 : NUM_FLOORS, 3, i % 4);
+    elevator.current_floor = 3;
+    elevator.state = UP;
+    elevator.direction = UP;
+
+    start = ktime_get_ns();
+    for (i = 0; i < BENCH_DEPTH; i++) {
+        next = determine_next_direction();
+        if (needs_to_unload() || has_waiting_pets())
+            next = LOADING;
+    }
+    bench_report(test, "determine_next_direction", ktime_get_ns() - start, BENCH_DEPTH, BUDGET_DECISION_NS);
+
+    KUNIT_EXPECT_EQ(test, next, UP);
+}
+
+static void bench_dispatch_test(struct kunit *test) {
+    u64 moves[2], stops[2];
+    int policy;
+
+    // Trips per delivered pet with the old board-everyone policy (0) and collective control (1)
+    for (policy = 0; policy < 2; policy++) {
+        elevator_test_init(test);
+        moves[policy] = test_simulate(test, policy, &stops[policy]);
+        kunit_info(test, "%s: %llu.%02llu floors and %llu.%02llu stops per delivered pet\n",
+                   policy ? "collective" : "board everyone",
+                   moves[policy] / SIM_PETS, moves[policy] * 100 / SIM_PETS % 100,
+                   stops[policy] / SIM_PETS, stops[policy] * 100 / SIM_PETS % 100);
+    }
+
+    // The workload is fixed, so collective control must not travel further than before
+    KUNIT_EXPECT_LE(test, moves[1], moves[0]);
+}
+
+static struct kunit_case elevator_test_cases[] = {
+    KUNIT_CASE(can_board_pet_empty_test),
+    KUNIT_CASE(can_board_pet_capacity_test),
+    KUNIT_CASE(can_board_pet_weight_test),
+    KUNIT_CASE(load_pets_fifo_test),
+    KUNIT_CASE(load_pets_head_of_line_test),
+    KUNIT_CASE(load_pets_capacity_test),
+    KUNIT_CASE(load_pets_stopping_test),
+    KUNIT_CASE(load_pets_ring_wrap_test),
+    KUNIT_CASE(load_pets_ring_shrink_test),
+    KUNIT_CASE(load_pets_coalesce_test),
+    KUNIT_CASE(load_pets_coalesce_weight_test),
+    KUNIT_CASE(load_pets_run_limit_test),
+    KUNIT_CASE(hall_call_queues_test),
+    KUNIT_CASE(collective_sweep_test),
+    KUNIT_CASE(collective_pass_by_test),
+    KUNIT_CASE(collective_reverse_test),
+    KUNIT_CASE(collective_pet_above_test),
+    KUNIT_CASE(non_collective_test),
+    KUNIT_CASE(unload_pets_test),
+    KUNIT_CASE(unload_pets_none_test),
+    KUNIT_CASE(direction_idle_test),
+    KUNIT_CASE(direction_offline_test),
+    KUNIT_CASE(direction_stop_delivers_onboard_test),
+    KUNIT_CASE(direction_waiting_test),
+    KUNIT_CASE(direction_keeps_sweep_test),
+    KUNIT_CASE(direction_onboard_first_test),
+    KUNIT_CASE(direction_full_test),
+    KUNIT_CASE(issue_request_validation_test),
+    KUNIT_CASE(start_stop_test),
+    KUNIT_CASE(proc_seek_test),
+    KUNIT_CASE(proc_show_test),
+    KUNIT_CASE(proc_partial_read_test),
+    KUNIT_CASE(proc_resume_test),
+    KUNIT_CASE(lockstat_bucket_test),
+    KUNIT_CASE(lockstat_site_test),
+    KUNIT_CASE(bench_queue_test),
+    KUNIT_CASE(bench_load_unload_test),
+    KUNIT_CASE(bench_load_unload_runs_test),
+    KUNIT_CASE(bench_decision_test),
+    KUNIT_CASE(bench_dispatch_test),
+    {}
+};
+
+static struct kunit_suite elevator_test_suite = {
+    .name = "elevator",
+    .init = elevator_test_init,
+    .exit = elevator_test_exit,
+    .test_cases = elevator_test_cases,
+};
+
+kunit_test_suite(elevator_test_suite);
@@ -0,0 +1,41 @@
+#!/bin/sh
+# Builds the elevator module with its KUnit suite, boots it under User-Mode Linux
+# and exits non-zero if any test fails or no results come back.
+#
+# Usage: run_kunit.sh [insmod parameters...]
+#   LINUX_SRC  Linux source tree with tools/testing/kunit (default ~/linux)
+#   UML_KDIR   UML build directory (default $LINUX_SRC/.kunit)
+set -eu
+
+HERE=$(cd "$(dirname "$0")" && pwd)
+PART3=$(cd "$HERE/../.." && pwd)
+LINUX_SRC=${LINUX_SRC:-$HOME/linux}
+UML_KDIR=${UML_KDIR:-$LINUX_SRC/.kunit}
+KUNIT_PY="$LINUX_SRC/tools/testing/kunit/kunit.py"
+
+# UML kernel with KUnit, then the module against it
+(cd "$LINUX_SRC" && "$KUNIT_PY" build --kunitconfig="$HERE/.kunitconfig" --build_dir="$UML_KDIR")
+make -C "$UML_KDIR" M="$PART3" ARCH=um KUNIT=1 modules
+
+WORK=$(mktemp -d "${TMPDIR:-/tmp}/elevator-kunit.XXXXXX")
+trap 'rm -rf "$WORK"' EXIT
+
+# Init for the UML guest: load the module (the suite runs on load) and power off
+cat > "$WORK/init" <<INIT
+#!/bin/sh
+mount -t proc proc /proc
+insmod "$PART3/elevator.ko" $*
+poweroff -f || echo o > /proc/sysrq-trigger
+INIT
+chmod +x "$WORK/init"
+
+# The host filesystem is the guest's read-only root, so the module and init are visible
+timeout 600 "$UML_KDIR/linux" mem=256M console=tty rootfstype=hostfs ro init="$WORK/init" \
+    > "$WORK/console.log" 2>&1 || true
+
+# kunit.py parse fails on any "not ok"; also fail if the suite never reported
+"$KUNIT_PY" parse "$WORK/console.log"
+if ! grep -Eq '^[[:space:]]*ok [0-9]+ elevator$' "$WORK/console.log"; then
+    echo "run_kunit.sh: no result for the elevator suite" >&2
+    exit 1
+fi